@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+if [ ! -d subprojects ]; then
+    meson wrap install gtest
+fi
+if [ ! -f subprojects/google-benchmark.wrap ]; then
+    meson wrap install google-benchmark
+fi
+if [ ! -d out-bench ]; then
+    CXX=g++ \
+    meson out-bench --buildtype=release -Db_sanitize=none -Dbench=true
+else
+    meson configure out-bench -Dbench=true
+fi
+rm -f out-bench/bitarray-bench.json
+meson test -C out-bench --benchmark --print-errorlogs "$@" || exit
+if [ ! -f out-bench/bitarray-bench.json ]; then
+    echo "no results, google benchmark not found?" >&2
+    exit 1
+fi
+echo "results in out-bench/bitarray-bench.json"
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "bitarray.hh"
+
+// n-way union/intersection/xor of many same-size bitsets
+//
+// rather than folding pairwise, which streams the whole accumulator through memory once per input,
+// the inputs are combined one cache-sized block at a time, so the accumulator block stays in L1
+// and each input is read exactly once
+// an intersection stops reading further inputs for a block as soon as that block is all zero
+//
+// inputs is a range of bitarrays, bitvectors or bitspans, or pointers to them,
+// use bitarray::view() to mix different storage types in one range
+
+namespace bitarray::detail
+{
+    template <bool Intersect, typename Inputs, typename Op, typename Emit>
+    void aggregate(const Inputs &inputs, size_t words, Op op, Emit emit)
+    {
+        using WordType = input_word_type<Inputs>;
+        constexpr size_t BlockWords = 8192 / sizeof(WordType);
+        WordType acc[BlockWords];
+        for (size_t base = 0; base < words; base += BlockWords) {
+            size_t n = std::min(BlockWords, words - base);
+            auto it = std::begin(inputs);
+            const WordType *first = deref(*it).data().data() + base;
+            std::copy(first, first + n, acc);
+            ++it;
+            // up to four inputs per pass over the accumulator
+            while (it != std::end(inputs)) {
+                const WordType *x[4];
+                size_t m = 0;
+                for (; m < 4 && it != std::end(inputs); m++, ++it) {
+                    x[m] = deref(*it).data().data() + base;
+                }
+                WordType any = 0;
+                if (m == 4) {
+                    for (size_t w = 0; w < n; w++) {
+                        acc[w] = op(op(acc[w], x[0][w]), op(x[1][w], op(x[2][w], x[3][w])));
+                        any |= acc[w];
+                    }
+                } else {
+                    for (size_t i = 0; i < m; i++) {
+                        for (size_t w = 0; w < n; w++) {
+                            acc[w] = op(acc[w], x[i][w]);
+                            any |= acc[w];
+                        }
+                    }
+                }
+                if (Intersect && any == 0) {
+                    break;
+                }
+            }
+            emit(base, acc, n);
+        }
+    }
+
+    template <bool Intersect, typename Inputs, typename Op>
+    bitvector<input_word_type<Inputs>> aggregate_all(const Inputs &inputs, Op op)
+    {
+        using WordType = input_word_type<Inputs>;
+        if (std::empty(inputs)) {
+            return bitvector<WordType>(0);
+        }
+        size_t size = common_size(inputs);
+        std::vector<WordType> out(words_needed<WordType>(size));
+        aggregate<Intersect>(inputs, out.size(), op, [&](size_t base, const WordType *acc, size_t n) {
+            std::copy(acc, acc + n, out.begin() + base);
+        });
+        return bitvector<WordType>(size, std::move(out));
+    }
+
+    template <bool Intersect, typename Inputs, typename Op>
+    size_t aggregate_count(const Inputs &inputs, Op op)
+    {
+        using WordType = input_word_type<Inputs>;
+        if (std::empty(inputs)) {
+            return 0;
+        }
+        size_t size = common_size(inputs);
+        size_t count = 0;
+        aggregate<Intersect>(inputs, words_needed<WordType>(size), op, [&](size_t, const WordType *acc, size_t n) {
+            for (size_t w = 0; w < n; w++)
+                count += bitvector<WordType>::word_popcount(acc[w]);
+        });
+        return count;
+    }
+}
+
+namespace bitarray {
+    template <typename Inputs>
+    bitvector<detail::input_word_type<Inputs>> union_all(const Inputs &inputs)
+    {
+        return detail::aggregate_all<false>(inputs, std::bit_or<detail::input_word_type<Inputs>>{});
+    }
+    template <typename Inputs>
+    bitvector<detail::input_word_type<Inputs>> intersect_all(const Inputs &inputs)
+    {
+        return detail::aggregate_all<true>(inputs, std::bit_and<detail::input_word_type<Inputs>>{});
+    }
+    template <typename Inputs>
+    bitvector<detail::input_word_type<Inputs>> xor_all(const Inputs &inputs)
+    {
+        return detail::aggregate_all<false>(inputs, std::bit_xor<detail::input_word_type<Inputs>>{});
+    }
+
+    // the cardinality of the result, without materialising it
+    template <typename Inputs>
+    size_t union_count(const Inputs &inputs)
+    {
+        return detail::aggregate_count<false>(inputs, std::bit_or<detail::input_word_type<Inputs>>{});
+    }
+    template <typename Inputs>
+    size_t intersect_count(const Inputs &inputs)
+    {
+        return detail::aggregate_count<true>(inputs, std::bit_and<detail::input_word_type<Inputs>>{});
+    }
+    template <typename Inputs>
+    size_t xor_count(const Inputs &inputs)
+    {
+        return detail::aggregate_count<false>(inputs, std::bit_xor<detail::input_word_type<Inputs>>{});
+    }
+}
@@ -0,0 +1,335 @@
+#include "bitarray.hh"
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// every benchmark runs on two containers plus a fixed list of random positions,
+// whole container operations report bytes/s, single bit operations report items/s
+// the containers are random, except for operations that can stop early,
+// which get the input that makes them scan everything
+
+namespace {
+constexpr size_t num_positions = 1024;
+constexpr size_t shift = 13;
+// operations returning a new container put it on the stack, so are only run up to this size
+constexpr size_t max_copy_bits = size_t{1} << 18;
+
+template <typename WordType>
+std::string word_name()
+{
+    return "u" + std::to_string(sizeof(WordType) * 8);
+}
+
+template <typename WordType>
+WordType random_word(std::mt19937_64 &rng)
+{
+    if constexpr (sizeof(WordType) <= 8) {
+        return static_cast<WordType>(rng());
+    } else {
+        return (static_cast<WordType>(rng()) << 64) | rng();
+    }
+}
+
+template <size_t Bits, typename WordType>
+std::unique_ptr<bitarray::bitarray<Bits, WordType>> make_random(std::mt19937_64 &rng, bitarray::bitarray<Bits, WordType> *)
+{
+    auto x = std::make_unique<bitarray::bitarray<Bits, WordType>>();
+    for (auto &w : x->data())
+        w = random_word<WordType>(rng);
+    constexpr size_t WordBits = std::numeric_limits<WordType>::digits;
+    if constexpr (Bits % WordBits != 0) {
+        x->data().back() &= (static_cast<WordType>(1) << (Bits % WordBits)) - 1;
+    }
+    return x;
+}
+
+template <size_t Bits>
+std::unique_ptr<std::bitset<Bits>> make_random(std::mt19937_64 &rng, std::bitset<Bits> *)
+{
+    // not guaranteed by the standard, but true of all the major implementations
+    static_assert(std::is_trivially_copyable_v<std::bitset<Bits>>);
+    static_assert(Bits % 64 == 0);
+    auto x = std::make_unique<std::bitset<Bits>>();
+    for (size_t i = 0; i < sizeof(*x); i += 8) {
+        uint64_t w = rng();
+        std::memcpy(reinterpret_cast<char *>(x.get()) + i, &w, 8);
+    }
+    return x;
+}
+
+template <size_t Bits>
+struct vector_bool : std::vector<bool>
+{
+    vector_bool() : std::vector<bool>(Bits) {}
+};
+
+template <size_t Bits>
+std::unique_ptr<vector_bool<Bits>> make_random(std::mt19937_64 &rng, vector_bool<Bits> *)
+{
+    auto x = std::make_unique<vector_bool<Bits>>();
+    for (size_t i = 0; i < Bits; i += 64) {
+        uint64_t w = rng();
+        for (size_t j = 0; j < 64 && i + j < Bits; j++)
+            (*x)[i + j] = (w >> j) & 1;
+    }
+    return x;
+}
+
+template <typename C>
+void fill(C &x, bool value)
+{
+    if (value) {
+        x.set();
+    } else {
+        x.reset();
+    }
+}
+
+template <size_t Bits>
+void fill(vector_bool<Bits> &x, bool value)
+{
+    std::fill(x.begin(), x.end(), value);
+}
+
+enum class kind { whole, positions };
+// random, a all zero, a all one, or b a copy of a
+enum class input { random, zeros, ones, equal };
+
+template <typename C, size_t Bits, typename F>
+void add(const std::string &container, const std::string &op, kind k, input in, F f)
+{
+    std::string name = container + "/" + op + "/" + std::to_string(Bits);
+    benchmark::RegisterBenchmark(name.c_str(), [k, in, f](benchmark::State &state) {
+        std::mt19937_64 rng{1};
+        auto a = make_random(rng, static_cast<C *>(nullptr));
+        auto b = make_random(rng, static_cast<C *>(nullptr));
+        if (in == input::zeros || in == input::ones) {
+            fill(*a, in == input::ones);
+        } else if (in == input::equal) {
+            *b = *a;
+        }
+        std::vector<size_t> positions(num_positions);
+        for (auto &p : positions)
+            p = rng() % Bits;
+        for (auto _ : state) {
+            f(*a, *b, positions);
+            benchmark::ClobberMemory();
+        }
+        if (k == kind::whole) {
+            state.SetBytesProcessed(state.iterations() * (Bits / 8));
+        } else {
+            state.SetItemsProcessed(state.iterations() * positions.size());
+        }
+    });
+}
+
+template <typename C, size_t Bits, typename F>
+void add(const std::string &container, const std::string &op, kind k, F f)
+{
+    add<C, Bits>(container, op, k, input::random, f);
+}
+
+using positions_t = std::vector<size_t>;
+
+// operations shared by bitarray and std::bitset, under the same names
+template <typename C, size_t Bits>
+void add_common(const std::string &container)
+{
+    add<C, Bits>(container, "all", kind::whole, input::ones, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.all()); });
+    add<C, Bits>(container, "any", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.any()); });
+    add<C, Bits>(container, "none", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.none()); });
+    add<C, Bits>(container, "count", kind::whole, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.count()); });
+    add<C, Bits>(container, "set", kind::whole, [](C &a, C &, const positions_t &) { a.set(); });
+    add<C, Bits>(container, "reset", kind::whole, [](C &a, C &, const positions_t &) { a.reset(); });
+    add<C, Bits>(container, "flip", kind::whole, [](C &a, C &, const positions_t &) { a.flip(); });
+    add<C, Bits>(container, "and", kind::whole, [](C &a, C &b, const positions_t &) { a &= b; });
+    add<C, Bits>(container, "or", kind::whole, [](C &a, C &b, const positions_t &) { a |= b; });
+    add<C, Bits>(container, "xor", kind::whole, [](C &a, C &b, const positions_t &) { a ^= b; });
+    add<C, Bits>(container, "shift_left", kind::whole, [](C &a, C &, const positions_t &) { a <<= shift; });
+    add<C, Bits>(container, "shift_right", kind::whole, [](C &a, C &, const positions_t &) { a >>= shift; });
+    add<C, Bits>(container, "equal", kind::whole, input::equal, [](C &a, C &b, const positions_t &) { benchmark::DoNotOptimize(a == b); });
+    add<C, Bits>(container, "set_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.set(i);
+    });
+    add<C, Bits>(container, "reset_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.reset(i);
+    });
+    add<C, Bits>(container, "flip_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.flip(i);
+    });
+    add<C, Bits>(container, "test_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            benchmark::DoNotOptimize(static_cast<bool>(a[i]));
+    });
+    add<C, Bits>(container, "test", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            benchmark::DoNotOptimize(a.test(i));
+    });
+    if constexpr (Bits <= max_copy_bits) {
+        add<C, Bits>(container, "shift_left_copy", kind::whole, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a << shift); });
+        add<C, Bits>(container, "shift_right_copy", kind::whole, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a >> shift); });
+    }
+}
+
+template <size_t Bits, typename WordType>
+void add_bitarray()
+{
+    using C = bitarray::bitarray<Bits, WordType>;
+    std::string container = "bitarray<" + word_name<WordType>() + ">";
+    add_common<C, Bits>(container);
+    add<C, Bits>(container, "countr_zero", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.countr_zero()); });
+    add<C, Bits>(container, "countr_one", kind::whole, input::ones, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.countr_one()); });
+    add<C, Bits>(container, "countl_zero", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.countl_zero()); });
+    add<C, Bits>(container, "countl_one", kind::whole, input::ones, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.countl_one()); });
+    add<C, Bits>(container, "bit_width", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.bit_width()); });
+    add<C, Bits>(container, "count_and", kind::whole, [](C &a, C &b, const positions_t &) { benchmark::DoNotOptimize(a.count_and(b)); });
+    add<C, Bits>(container, "count_or", kind::whole, [](C &a, C &b, const positions_t &) { benchmark::DoNotOptimize(a.count_or(b)); });
+    add<C, Bits>(container, "count_xor", kind::whole, [](C &a, C &b, const positions_t &) { benchmark::DoNotOptimize(a.count_xor(b)); });
+    add<C, Bits>(container, "popcount", kind::whole, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.popcount()); });
+    add<C, Bits>(container, "has_single_bit", kind::whole, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.has_single_bit()); });
+    if constexpr (Bits <= max_copy_bits) {
+        add<C, Bits>(container, "bit_floor", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.bit_floor()); });
+        add<C, Bits>(container, "bit_ceil", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a.bit_ceil()); });
+    }
+    add<C, Bits>(container, "wordswap", kind::whole, [](C &a, C &, const positions_t &) { a.wordswap(); });
+    add<C, Bits>(container, "at", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            benchmark::DoNotOptimize(a.at(i));
+    });
+    // the unchecked versions, for comparison with the bounds checked set_pos/reset_pos/flip_pos/test
+    add<C, Bits>(container, "unchecked_set", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.unchecked_set(i);
+    });
+    add<C, Bits>(container, "unchecked_reset", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.unchecked_reset(i);
+    });
+    add<C, Bits>(container, "unchecked_flip", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.unchecked_flip(i);
+    });
+    add<C, Bits>(container, "unchecked_test", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            benchmark::DoNotOptimize(a.unchecked_test(i));
+    });
+    add<C, Bits>(container, "get_word_at_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            benchmark::DoNotOptimize(a.get_word_at_pos(i));
+    });
+    add<C, Bits>(container, "set_word_at_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a.set_word_at_pos(static_cast<WordType>(i), i);
+    });
+}
+
+template <size_t Bits>
+void add_bitset()
+{
+    using C = std::bitset<Bits>;
+    std::string container = "std::bitset";
+    add_common<C, Bits>(container);
+#ifdef __GLIBCXX__
+    add<C, Bits>(container, "countr_zero", kind::whole, input::zeros, [](C &a, C &, const positions_t &) { benchmark::DoNotOptimize(a._Find_first()); });
+#endif
+}
+
+template <size_t Bits>
+void add_vector_bool()
+{
+    using C = vector_bool<Bits>;
+    std::string container = "std::vector<bool>";
+    add<C, Bits>(container, "all", kind::whole, input::ones, [](C &a, C &, const positions_t &) {
+        benchmark::DoNotOptimize(std::find(a.begin(), a.end(), false) == a.end());
+    });
+    add<C, Bits>(container, "any", kind::whole, input::zeros, [](C &a, C &, const positions_t &) {
+        benchmark::DoNotOptimize(std::find(a.begin(), a.end(), true) != a.end());
+    });
+    add<C, Bits>(container, "none", kind::whole, input::zeros, [](C &a, C &, const positions_t &) {
+        benchmark::DoNotOptimize(std::find(a.begin(), a.end(), true) == a.end());
+    });
+    add<C, Bits>(container, "count", kind::whole, [](C &a, C &, const positions_t &) {
+        benchmark::DoNotOptimize(std::count(a.begin(), a.end(), true));
+    });
+    add<C, Bits>(container, "countr_zero", kind::whole, input::zeros, [](C &a, C &, const positions_t &) {
+        benchmark::DoNotOptimize(std::find(a.begin(), a.end(), true) - a.begin());
+    });
+    add<C, Bits>(container, "set", kind::whole, [](C &a, C &, const positions_t &) { std::fill(a.begin(), a.end(), true); });
+    add<C, Bits>(container, "reset", kind::whole, [](C &a, C &, const positions_t &) { std::fill(a.begin(), a.end(), false); });
+    add<C, Bits>(container, "flip", kind::whole, [](C &a, C &, const positions_t &) { a.flip(); });
+    add<C, Bits>(container, "and", kind::whole, [](C &a, C &b, const positions_t &) {
+        std::transform(a.begin(), a.end(), b.begin(), a.begin(), std::bit_and<bool>{});
+    });
+    add<C, Bits>(container, "or", kind::whole, [](C &a, C &b, const positions_t &) {
+        std::transform(a.begin(), a.end(), b.begin(), a.begin(), std::bit_or<bool>{});
+    });
+    add<C, Bits>(container, "xor", kind::whole, [](C &a, C &b, const positions_t &) {
+        std::transform(a.begin(), a.end(), b.begin(), a.begin(), std::bit_xor<bool>{});
+    });
+    add<C, Bits>(container, "shift_left", kind::whole, [](C &a, C &, const positions_t &) {
+        std::copy_backward(a.begin(), a.end() - shift, a.end());
+        std::fill(a.begin(), a.begin() + shift, false);
+    });
+    add<C, Bits>(container, "shift_right", kind::whole, [](C &a, C &, const positions_t &) {
+        std::copy(a.begin() + shift, a.end(), a.begin());
+        std::fill(a.end() - shift, a.end(), false);
+    });
+    add<C, Bits>(container, "equal", kind::whole, input::equal, [](C &a, C &b, const positions_t &) { benchmark::DoNotOptimize(a == b); });
+    add<C, Bits>(container, "set_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a[i] = true;
+    });
+    add<C, Bits>(container, "reset_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a[i] = false;
+    });
+    add<C, Bits>(container, "flip_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            a[i].flip();
+    });
+    add<C, Bits>(container, "test_pos", kind::positions, [](C &a, C &, const positions_t &p) {
+        for (auto i : p)
+            benchmark::DoNotOptimize(static_cast<bool>(a[i]));
+    });
+}
+
+template <size_t Bits>
+void add_size()
+{
+    add_bitarray<Bits, uint8_t>();
+    add_bitarray<Bits, uint16_t>();
+    add_bitarray<Bits, uint32_t>();
+    add_bitarray<Bits, uint64_t>();
+    add_bitarray<Bits, __uint128_t>();
+    add_bitset<Bits>();
+    add_vector_bool<Bits>();
+}
+}
+
+int main(int argc, char **argv)
+{
+    add_size<64>();
+    add_size<size_t{1} << 12>();
+    add_size<size_t{1} << 18>();
+    add_size<size_t{1} << 24>();
+    add_size<size_t{1} << 30>();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,7 +1,4 @@
-template <typename T>
-concept VariableSize = requires(T t) {
-    t._size;
-};
+#pragma once
 
 template <typename Specific, typename Traits>
 struct bitarray_impl
@@ -9,19 +6,25 @@ struct bitarray_impl
     using Container = typename Traits::Container;
     using WordType = Container::value_type;
     using self_type = bitarray_impl<Specific, Traits>;
-    static constexpr auto variable_sized = VariableSize<Specific>;
-    Container data_;
+    Container data_ {};
 
-    bitarray_impl() = default;
-    bitarray_impl(Container c) : data_(c) {}
+    constexpr bitarray_impl() = default;
+    constexpr bitarray_impl(Container c) : data_(c) {}
     template <typename Other>
-    bitarray_impl(Other l)
+    constexpr bitarray_impl(Other l)
     {
         std::copy(l.begin(), l.begin() + std::min(l.size(), data_.size()), data_.begin());
         sanitize();
     }
 
     static constexpr auto WordBits = std::numeric_limits<WordType>::digits;
+    // size in bits when it is part of the type, std::dynamic_extent otherwise
+    static constexpr size_t StaticBits = Traits::StaticBits;
+    static constexpr bool static_sized = StaticBits != std::dynamic_extent;
+    static constexpr size_t StaticWords = static_sized ? (StaticBits + WordBits - 1) / WordBits : std::dynamic_extent;
+    // sizes with few enough words get fully unrolled loops and a single word gets its own integer code paths
+    static constexpr bool single_word = StaticWords == 1;
+    static constexpr bool unrolled = static_sized && StaticWords <= 4;
 
     template <class CharT, class CTraits>
     friend std::basic_ostream<CharT, CTraits> &operator<<(std::basic_ostream<CharT, CTraits> &os, const self_type &x)
@@ -48,31 +51,48 @@ struct bitarray_impl
         return os;
     }
 
-    size_t size() const
+    constexpr size_t size() const
     {
-        if constexpr (!variable_sized)
+        if constexpr (static_sized)
         {
-            return std::size(data_) * WordBits;
+            return StaticBits;
         }
         else
         {
-            if (Specific::_size == std::dynamic_extent)
+            if (derived()._size == std::dynamic_extent)
             {
                 return std::size(data_) * WordBits;
             }
             else
             {
-                return Specific::_size;
+                return derived()._size;
             }
         }
     }
 
-    Container &data()
+    constexpr Container &data()
+    {
+        return data_;
+    }
+    constexpr const Container &data() const
     {
         return data_;
     }
+    static constexpr int word_popcount(WordType x) {
+        if constexpr (sizeof(WordType) <= 8) {
+            return std::popcount(x);
+        } else if (sizeof(WordType) <= 16) {
+            return std::popcount(static_cast<uint64_t>(x >> 64)) + std::popcount(static_cast<uint64_t>(x));
+        }
+    }
 
 private:
+    constexpr Specific &derived() {
+        return static_cast<Specific &>(*this);
+    }
+    constexpr const Specific &derived() const {
+        return static_cast<const Specific &>(*this);
+    }
     constexpr WordType zero() const {
         return static_cast<WordType>(0);
     }
@@ -82,174 +102,362 @@ private:
     constexpr WordType ones() const {
         return ~static_cast<WordType>(0);
     }
+    static constexpr int word_countr_zero(WordType x) {
+        if constexpr (sizeof(WordType) <= 8) {
+            return std::countr_zero(x);
+        } else if (sizeof(WordType) <= 16) {
+            if (static_cast<uint64_t>(x) != 0)
+                return std::countr_zero(static_cast<uint64_t>(x));
+            return 64 + std::countr_zero(static_cast<uint64_t>(x >> 64));
+        }
+    }
+    static constexpr int word_countl_zero(WordType x) {
+        if constexpr (sizeof(WordType) <= 8) {
+            return std::countl_zero(x);
+        } else if (sizeof(WordType) <= 16) {
+            if (static_cast<uint64_t>(x >> 64) != 0)
+                return std::countl_zero(static_cast<uint64_t>(x >> 64));
+            return 64 + std::countl_zero(static_cast<uint64_t>(x));
+        }
+    }
+    static constexpr int word_countr_one(WordType x) {
+        return word_countr_zero(static_cast<WordType>(~x));
+    }
+    static constexpr int word_countl_one(WordType x) {
+        return word_countl_zero(static_cast<WordType>(~x));
+    }
+
+    constexpr bool has_tail() const {
+        if constexpr (static_sized) {
+            return StaticBits % WordBits != 0;
+        } else {
+            return size() % WordBits != 0;
+        }
+    }
+    // the valid bits of the last word
+    constexpr WordType tail_mask() const {
+        if (!has_tail()) {
+            return ones();
+        }
+        return ones() >> (WordBits - size() % WordBits);
+    }
+    constexpr WordType &word(size_t pos) {
+        if constexpr (single_word) {
+            return data_[0];
+        } else {
+            return data_[pos / WordBits];
+        }
+    }
+    constexpr WordType word(size_t pos) const {
+        if constexpr (single_word) {
+            return data_[0];
+        } else {
+            return data_[pos / WordBits];
+        }
+    }
+    constexpr WordType bit(size_t pos) const {
+        return one() << (pos % WordBits);
+    }
+    constexpr size_t storage_bytes() const {
+        return std::size(data_) * sizeof(WordType);
+    }
+    constexpr void check(size_t pos, const char *function) const {
+        if (pos >= size()) {
+            throw std::out_of_range{std::string{function} + " called with pos " + std::to_string(pos) + " on bitset of size " + std::to_string(size())};
+        }
+    }
+    template <typename F>
+    constexpr void for_each_word(F f) const {
+        if constexpr (unrolled) {
+            [&]<size_t... I>(std::index_sequence<I...>) {
+                (f(I), ...);
+            }(std::make_index_sequence<StaticWords>{});
+        } else {
+            for (size_t i = 0; i < std::size(data_); i++)
+                f(i);
+        }
+    }
 
 protected:
-    void sanitize() {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wshift-count-overflow"
-        if (size() % WordBits != 0) {
-            data_.back() &= ones() >> (WordBits - size() % WordBits);
+    constexpr void sanitize() {
+        if (has_tail()) {
+            data_.back() &= tail_mask();
         }
-#pragma GCC diagnostic pop
     }
 
 public:
-    bool all() const {
-        if (size() % WordBits == 0) {
-            for (size_t i = 0; i < std::size(data_); i++)
-                if (data_[i] != ones())
-                    return false;
-        } else {
-            if (data_.back() != ones() >> (WordBits - size() % WordBits))
-                return false;
-            for (size_t i = 0; i + 1 < std::size(data_); i++)
-                if (data_[i] != ones())
-                    return false;
+    constexpr bool all() const {
+        BITARRAY_PROFILE_OP(all, storage_bytes());
+        if constexpr (single_word) {
+            return data_[0] == tail_mask();
         }
-        return true;
+        for (size_t i = 0; i + 1 < std::size(data_); i++)
+            if (data_[i] != ones())
+                return false;
+        return std::size(data_) == 0 || data_.back() == tail_mask();
     }
-    bool any() const {
+    constexpr bool any() const {
+        BITARRAY_PROFILE_OP(any, storage_bytes());
+        if constexpr (single_word) {
+            return data_[0] != 0;
+        }
         for (auto &x : data_)
             if (x != 0)
                 return true;
         return false;
     }
-    bool none() const {
-        for (auto &x : data_)
-            if (x != 0)
-                return false;
-        return true;
+    constexpr bool none() const {
+        BITARRAY_PROFILE_OP(none, storage_bytes());
+        return !any();
     }
-    int popcount() const {
+    constexpr int popcount() const {
         return count();
     }
-    size_t count() const {
+    constexpr size_t count() const {
+        BITARRAY_PROFILE_OP(count, storage_bytes());
         size_t count = 0;
-        for (auto &x : data_)
-            if constexpr (sizeof(WordType) <= 8) {
-                count += std::popcount(x);
-            } else if (sizeof(WordType) <= 16) {
-                count += std::popcount(static_cast<uint64_t>(x >> 64)) + std::popcount(static_cast<uint64_t>(x));
-            }
+        for_each_word([&](size_t i) {
+            count += word_popcount(data_[i]);
+        });
         return count;
     }
-    bool has_single_bit() const {
+    // fused popcount((*this OP rhs)), without materialising the temporary
+    constexpr size_t count_and(const self_type& rhs) const {
+        BITARRAY_PROFILE_OP(count_and, 2 * storage_bytes());
+        size_t count = 0;
+        for_each_word([&](size_t i) {
+            count += word_popcount(data_[i] & rhs.data_[i]);
+        });
+        return count;
+    }
+    constexpr size_t count_or(const self_type& rhs) const {
+        BITARRAY_PROFILE_OP(count_or, 2 * storage_bytes());
+        size_t count = 0;
+        for_each_word([&](size_t i) {
+            count += word_popcount(data_[i] | rhs.data_[i]);
+        });
+        return count;
+    }
+    constexpr size_t count_xor(const self_type& rhs) const {
+        BITARRAY_PROFILE_OP(count_xor, 2 * storage_bytes());
+        size_t count = 0;
+        for_each_word([&](size_t i) {
+            count += word_popcount(data_[i] ^ rhs.data_[i]);
+        });
+        return count;
+    }
+    constexpr bool has_single_bit() const {
         return count() == 1;
     }
-    int countr_zero() const {
+    constexpr int countr_zero() const {
+        BITARRAY_PROFILE_OP(countr_zero, storage_bytes());
+        if constexpr (single_word) {
+            return std::min<int>(word_countr_zero(data_[0]), size());
+        }
         for (size_t i = 0; i < std::size(data_); i++)
             if (data_[i] != 0)
-                return i * WordBits + std::countr_zero(data_[i]);
+                return i * WordBits + word_countr_zero(data_[i]);
         return size();
     }
-    int countr_one() const {
+    constexpr int countr_one() const {
+        BITARRAY_PROFILE_OP(countr_one, storage_bytes());
+        if constexpr (single_word) {
+            return word_countr_one(data_[0]);
+        }
         for (size_t i = 0; i < std::size(data_); i++)
             if (data_[i] != ones())
-                return i * WordBits + std::countr_one(data_[i]);
+                return i * WordBits + word_countr_one(data_[i]);
         return size();
     }
-    int countl_zero() const {
+    constexpr int countl_zero() const {
+        BITARRAY_PROFILE_OP(countl_zero, storage_bytes());
+        if constexpr (single_word) {
+            return word_countl_zero(data_[0]) - (WordBits - StaticBits);
+        }
         for (size_t i = std::size(data_); i--;)
             if (data_[i] != 0)
-                return size() - i * WordBits - (WordBits - std::countl_zero(data_[i]));
+                return size() - i * WordBits - (WordBits - word_countl_zero(data_[i]));
         return size();
     }
-    int countl_one() const {
+    constexpr int countl_one() const {
+        BITARRAY_PROFILE_OP(countl_one, storage_bytes());
+        if constexpr (single_word) {
+            return word_countl_one(static_cast<WordType>(data_[0] << (WordBits - StaticBits)));
+        }
         size_t i = std::size(data_);
-        if (size() % WordBits != 0) {
-            if (data_.back() != (ones() >> (WordBits - size() % WordBits)))
-                return std::countl_one(data_.back() << (WordBits - size() % WordBits));
+        if (has_tail()) {
+            if (data_.back() != tail_mask())
+                return word_countl_one(static_cast<WordType>(data_.back() << (WordBits - size() % WordBits)));
             i--;
         }
         for (; i--;)
             if (data_[i] != ones())
-                return size() - i * WordBits - (WordBits - std::countl_one(data_[i]));
+                return size() - i * WordBits - (WordBits - word_countl_one(data_[i]));
         return size();
     }
-    int bit_width() const {
+    constexpr int bit_width() const {
+        BITARRAY_PROFILE_OP(bit_width, storage_bytes());
         return size() - countl_zero();
     }
-    self_type bit_floor() const {
+    constexpr Specific bit_floor() const {
+        BITARRAY_PROFILE_OP(bit_floor, storage_bytes());
+        Specific x = derived();
         int w = bit_width();
-        reset();
+        x.reset();
         if (w != 0) {
-            set(w - 1);
+            x.unchecked_set(w - 1);
         }
-        return *this;
+        return x;
     }
-    self_type bit_ceil() const {
+    constexpr Specific bit_ceil() const {
+        BITARRAY_PROFILE_OP(bit_ceil, storage_bytes());
+        Specific x = derived();
         int w = bit_width();
-        bool x = has_single_bit();
-        reset();
-        if (x) {
-            set(w - 1);
+        bool single = has_single_bit();
+        x.reset();
+        if (single) {
+            x.unchecked_set(w - 1);
         } else {
-            set(w);
+            x.set(w);
         }
-        return *this;
+        return x;
     }
 
 
 
 
 
-    void wordswap() {
+    constexpr void wordswap() {
+        BITARRAY_PROFILE_OP(wordswap, storage_bytes());
         std::reverse(std::begin(data_), std::end(data_));
     }
-    void byteswap() {
+    constexpr void byteswap() {
         wordswap();
         for (auto &x : data_)
         {
             //std::byteswap(x);
         }
     }
-    void bitswap() {
+    constexpr void bitswap() {
         byteswap();
         //TODO bitswap
     }
-    self_type set() {
-        for (auto &x : data_)
-            x = ones();
+    constexpr Specific &set() {
+        BITARRAY_PROFILE_OP(set, storage_bytes());
+        for_each_word([&](size_t i) {
+            data_[i] = ones();
+        });
         sanitize();
-        return *this;
+        return derived();
     }
-    constexpr self_type set(size_t pos, bool value = true) {
-        if (pos >= size()) {
-            throw std::out_of_range{"set() called with pos " + std::to_string(pos) + " on bitset of size " + std::to_string(size())};
-        }
+    constexpr Specific &set(size_t pos, bool value = true) {
+        check(pos, "set()");
+        return unchecked_set(pos, value);
+    }
+    constexpr Specific &unchecked_set(size_t pos, bool value = true) {
+        BITARRAY_PROFILE_OP(set_pos, sizeof(WordType));
         if (value) {
-            data_[pos / WordBits] |= one() << (pos % WordBits);
+            word(pos) |= bit(pos);
         } else {
-            data_[pos / WordBits] &= ~(one() << (pos % WordBits));
+            word(pos) &= ~bit(pos);
         }
-        return *this;
-    }
-    self_type reset() {
-        for (auto &x : data_)
-            x = zero();
-        return *this;
-    }
-    self_type reset(size_t pos) {
-        if (pos >= size()) {
-            throw std::out_of_range{"reset() called with pos " + std::to_string(pos) + " on bitset of size " + std::to_string(size())};
+        return derived();
+    }
+    // sets every index in indices, a random access range of integers
+    // all indices are bounds checked up front, so nothing is set if any is out of range
+    // strictly increasing input is set a word at a time, with whole words written directly for runs of consecutive indices
+    // anything else, unsorted or with duplicates, prefetches the words of upcoming indices
+    template <typename Indices>
+    constexpr Specific &set_indices(const Indices &indices) {
+        BITARRAY_PROFILE_OP(set_indices, std::size(indices) * sizeof(WordType));
+        auto p = std::begin(indices);
+        size_t n = std::size(indices);
+        if (n == 0) {
+            return derived();
         }
-        data_[pos / WordBits] &= ~(one() << (pos % WordBits));
-        return *this;
+        if (std::adjacent_find(p, std::end(indices), std::greater_equal<>()) == std::end(indices)) {
+            check(static_cast<size_t>(p[0]), "set_indices()");
+            check(static_cast<size_t>(p[n - 1]), "set_indices()");
+            for (size_t i = 0; i < n;) {
+                size_t pos = static_cast<size_t>(p[i]);
+                size_t w = pos / WordBits;
+                if (pos % WordBits == 0 && i + WordBits <= n && static_cast<size_t>(p[i + WordBits - 1]) == pos + WordBits - 1) {
+                    data_[w] = ones();
+                    i += WordBits;
+                    continue;
+                }
+                // the rest of this word's indices are accumulated in a register
+                size_t end = (w + 1) * WordBits;
+                WordType acc = zero();
+                do {
+                    acc |= bit(static_cast<size_t>(p[i]));
+                    i++;
+                } while (i < n && static_cast<size_t>(p[i]) < end);
+                data_[w] |= acc;
+            }
+        } else {
+            auto [min, max] = std::minmax_element(p, std::end(indices));
+            check(static_cast<size_t>(*min), "set_indices()");
+            check(static_cast<size_t>(*max), "set_indices()");
+            constexpr size_t prefetch_distance = 16;
+            for (size_t i = 0; i < n; i++) {
+                if (!std::is_constant_evaluated() && i + prefetch_distance < n) {
+                    __builtin_prefetch(&data_[static_cast<size_t>(p[i + prefetch_distance]) / WordBits], 1);
+                }
+                size_t pos = static_cast<size_t>(p[i]);
+                word(pos) |= bit(pos);
+            }
+        }
+        return derived();
+    }
+    // the positions of the set bits, in increasing order
+    template <typename Index = size_t>
+    constexpr std::vector<Index> to_indices() const {
+        BITARRAY_PROFILE_OP(to_indices, storage_bytes());
+        std::vector<Index> out;
+        out.reserve(count());
+        for (size_t i = 0; i < std::size(data_); i++) {
+            for (WordType x = data_[i]; x != 0; x &= x - 1) {
+                out.push_back(static_cast<Index>(i * WordBits + word_countr_zero(x)));
+            }
+        }
+        return out;
     }
-    self_type flip() {
-        for (auto &x : data_)
-            x = ~x;
+    constexpr Specific &reset() {
+        BITARRAY_PROFILE_OP(reset, storage_bytes());
+        for_each_word([&](size_t i) {
+            data_[i] = zero();
+        });
+        return derived();
+    }
+    constexpr Specific &reset(size_t pos) {
+        check(pos, "reset()");
+        return unchecked_reset(pos);
+    }
+    constexpr Specific &unchecked_reset(size_t pos) {
+        BITARRAY_PROFILE_OP(reset_pos, sizeof(WordType));
+        word(pos) &= ~bit(pos);
+        return derived();
+    }
+    constexpr Specific &flip() {
+        BITARRAY_PROFILE_OP(flip, storage_bytes());
+        for_each_word([&](size_t i) {
+            data_[i] = ~data_[i];
+        });
         sanitize();
-        return *this;
+        return derived();
     }
-    self_type flip(size_t pos) {
-        if (pos >= size()) {
-            throw std::out_of_range{"flip() called with pos " + std::to_string(pos) + " on bitset of size " + std::to_string(size())};
-        }
-        data_[pos / WordBits] ^= one() << (pos % WordBits);
-        return *this;
+    constexpr Specific &flip(size_t pos) {
+        check(pos, "flip()");
+        return unchecked_flip(pos);
     }
-    void set_word_at_pos(WordType x, size_t pos) {
+    constexpr Specific &unchecked_flip(size_t pos) {
+        BITARRAY_PROFILE_OP(flip_pos, sizeof(WordType));
+        word(pos) ^= bit(pos);
+        return derived();
+    }
+    constexpr void set_word_at_pos(WordType x, size_t pos) {
+        BITARRAY_PROFILE_OP(set_word_at_pos, 2 * sizeof(WordType));
         if (pos >= size()) {
             return;
         }
@@ -260,10 +468,9 @@ public:
             data_[pos / WordBits + 1] |= x >> (WordBits - offset);
         }
     }
-    WordType get_word_at_pos(size_t pos) const {
-        if (pos >= size()) {
-            throw std::out_of_range{"get_word_at_pos() called with pos " + std::to_string(pos) + " on bitset of size " + std::to_string(size())};
-        }
+    constexpr WordType get_word_at_pos(size_t pos) const {
+        BITARRAY_PROFILE_OP(get_word_at_pos, 2 * sizeof(WordType));
+        check(pos, "get_word_at_pos()");
         size_t offset = pos % WordBits;
         WordType out = data_[pos / WordBits] >> offset;
         if (offset != 0 && pos / WordBits + 1 < std::size(data_))
@@ -272,56 +479,81 @@ public:
         }
         return out;
     }
-    bool operator==(const self_type& rhs) const {
+    constexpr bool operator==(const self_type& rhs) const {
+        BITARRAY_PROFILE_OP(equal, 2 * storage_bytes());
         for (size_t i = 0; i < std::size(data_); i++)
             if (data_[i] != rhs.data_[i])
                 return false;
         return true;
     }
-    bool operator!=(const self_type& rhs) const {
+    constexpr bool operator!=(const self_type& rhs) const {
         return !(*this == rhs);
     }
+    constexpr bool test(size_t pos) const {
+        check(pos, "test()");
+        return unchecked_test(pos);
+    }
     constexpr bool at(size_t pos) const {
-        if (pos >= size()) {
-            throw std::out_of_range{"at() called with pos " + std::to_string(pos) + " on bitset of size " + std::to_string(size())};
-        }
-        return *this[pos];
+        check(pos, "at()");
+        return unchecked_test(pos);
+    }
+    constexpr bool unchecked_test(size_t pos) const {
+        BITARRAY_PROFILE_OP(test, sizeof(WordType));
+        return static_cast<bool>((word(pos) >> (pos % WordBits)) & 1);
     }
     constexpr bool operator[](size_t pos) const {
-        return static_cast<bool>((data_[pos / WordBits] >> (pos % WordBits)) & 1);
+        return unchecked_test(pos);
     }
 
-    self_type operator&=(const self_type& rhs) {
-        for (size_t i = 0; i < std::size(data_); i++)
+    constexpr Specific &operator&=(const self_type& rhs) {
+        BITARRAY_PROFILE_OP(and_, 2 * storage_bytes());
+        for_each_word([&](size_t i) {
             data_[i] &= rhs.data_[i];
-        return *this;
+        });
+        return derived();
     }
-    self_type operator|=(const self_type& rhs) {
-        for (size_t i = 0; i < std::size(data_); i++)
+    constexpr Specific &operator|=(const self_type& rhs) {
+        BITARRAY_PROFILE_OP(or_, 2 * storage_bytes());
+        for_each_word([&](size_t i) {
             data_[i] |= rhs.data_[i];
-        return *this;
+        });
+        return derived();
     }
-    self_type operator^=(const self_type& rhs) {
-        for (size_t i = 0; i < std::size(data_); i++)
+    constexpr Specific &operator^=(const self_type& rhs) {
+        BITARRAY_PROFILE_OP(xor_, 2 * storage_bytes());
+        for_each_word([&](size_t i) {
             data_[i] ^= rhs.data_[i];
+        });
         sanitize();
-        return *this;
-    }
-    self_type operator<<=(size_t shift) {
+        return derived();
+    }
+    constexpr Specific &operator<<=(size_t shift) {
+        BITARRAY_PROFILE_OP(shift_left, storage_bytes());
+        if constexpr (single_word) {
+            data_[0] = shift < StaticBits ? static_cast<WordType>(data_[0] << shift) : zero();
+            sanitize();
+            return derived();
+        }
         for (size_t i = std::size(data_); i--;)
         {
             auto x = data_[i];
             data_[i] = 0;
             set_word_at_pos(x, i * WordBits + shift);
         }
-        return *this;
+        sanitize();
+        return derived();
     }
-    self_type operator<<(size_t shift) {
-        self_type x = *this;
+    constexpr Specific operator<<(size_t shift) const {
+        Specific x = derived();
         x <<= shift;
         return x;
     }
-    self_type operator>>=(size_t shift) {
+    constexpr Specific &operator>>=(size_t shift) {
+        BITARRAY_PROFILE_OP(shift_right, storage_bytes());
+        if constexpr (single_word) {
+            data_[0] = shift < StaticBits ? static_cast<WordType>(data_[0] >> shift) : zero();
+            return derived();
+        }
         for (size_t i = 0; i < std::size(data_); i++)
         {
             if (shift + i * WordBits < size()) {
@@ -330,30 +562,32 @@ public:
                 data_[i] = 0;
             }
         }
-        return *this;
+        return derived();
     }
-    self_type operator>>(size_t shift) {
-        self_type x = *this;
+    constexpr Specific operator>>(size_t shift) const {
+        Specific x = derived();
         x >>= shift;
         return x;
     }
-    self_type rotl(int shift) {
+    constexpr Specific &rotl(int shift) {
+        BITARRAY_PROFILE_OP(rotl, storage_bytes());
         if (shift < 0) {
             return rotr(-shift);
         }
         shift %= size();
         //FIXME implement without temporaries
         //return (*this << shift) | (*this >> (size() - shift));
-        return *this;
+        return derived();
     }
-    self_type rotr(int shift) {
+    constexpr Specific &rotr(int shift) {
+        BITARRAY_PROFILE_OP(rotr, storage_bytes());
         if (shift < 0) {
             return rotl(-shift);
         }
         shift %= size();
         //FIXME implement without temporaries
         //return (*this >> shift) | (*this << (size() - shift));
-        return *this;
+        return derived();
     }
 
     /*
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bitarray.hh"
+
+// positional popcount over many same-size bitarrays/bitvectors/bitspans:
+// for every bit position, how many of the inputs have it set
+//
+// the inputs are summed into bit-sliced vertical counters, plane p holding bit p of every position's count,
+// pairs of inputs are folded in with a carry-save adder and the carry rippled into the higher planes
+// the work is done a block of words at a time with plain loops over the block,
+// which the compiler turns into AVX2/AVX-512 when targeting them
+
+namespace bitarray::detail
+{
+    template <typename WordType>
+    struct vertical_counters
+    {
+        static constexpr size_t BlockWords = 256 / sizeof(WordType);
+
+        size_t planes;
+        std::unique_ptr<WordType[]> data;
+        WordType carry[BlockWords];
+
+        vertical_counters(size_t max_count)
+            : planes(std::max<size_t>(std::bit_width(max_count), 1)), data(new WordType[planes * BlockWords])
+        {}
+
+        WordType *plane(size_t p)
+        {
+            return data.get() + p * BlockWords;
+        }
+
+        // counts the inputs' words [base, base + n) into the planes
+        template <typename Inputs>
+        void accumulate(const Inputs &inputs, size_t base, size_t n)
+        {
+            std::fill(data.get(), data.get() + planes * BlockWords, 0);
+            auto it = std::begin(inputs);
+            auto end = std::end(inputs);
+            WordType *p0 = plane(0);
+            while (it != end) {
+                const WordType *a = deref(*it).data().data() + base;
+                ++it;
+                if (it != end) {
+                    const WordType *b = deref(*it).data().data() + base;
+                    ++it;
+                    for (size_t w = 0; w < n; w++) {
+                        WordType u = p0[w] ^ a[w];
+                        carry[w] = (p0[w] & a[w]) | (u & b[w]);
+                        p0[w] = u ^ b[w];
+                    }
+                } else {
+                    for (size_t w = 0; w < n; w++) {
+                        carry[w] = p0[w] & a[w];
+                        p0[w] ^= a[w];
+                    }
+                }
+                ripple(1, n);
+            }
+        }
+
+        // adds carry into the planes from p upwards
+        void ripple(size_t p, size_t n)
+        {
+            for (; p < planes; p++) {
+                WordType *x = plane(p);
+                WordType any = 0;
+                for (size_t w = 0; w < n; w++) {
+                    WordType t = x[w] & carry[w];
+                    x[w] ^= carry[w];
+                    carry[w] = t;
+                    any |= t;
+                }
+                if (any == 0) {
+                    return;
+                }
+            }
+        }
+
+        // positions whose count is >= k, for k < 2^planes, bit-sliced comparison from the top plane down
+        void at_least(size_t k, WordType *out, size_t n)
+        {
+            WordType gt[BlockWords] = {};
+            WordType eq[BlockWords];
+            std::fill(eq, eq + n, static_cast<WordType>(~static_cast<WordType>(0)));
+            for (size_t p = planes; p--;) {
+                const WordType *x = plane(p);
+                if ((k >> p) & 1) {
+                    for (size_t w = 0; w < n; w++)
+                        eq[w] &= x[w];
+                } else {
+                    for (size_t w = 0; w < n; w++) {
+                        gt[w] |= eq[w] & x[w];
+                        eq[w] &= static_cast<WordType>(~x[w]);
+                    }
+                }
+            }
+            for (size_t w = 0; w < n; w++)
+                out[w] = gt[w] | eq[w];
+        }
+    };
+}
+
+namespace bitarray {
+    // counts[i] is the number of inputs with bit i set
+    // inputs is a range of same-size bitarrays, bitvectors or bitspans, or pointers to them
+    template <typename Inputs>
+    std::vector<uint32_t> positional_popcount(const Inputs &inputs)
+    {
+        using WordType = detail::input_word_type<Inputs>;
+        constexpr size_t WordBits = std::numeric_limits<WordType>::digits;
+        if (std::empty(inputs)) {
+            return {};
+        }
+        size_t size = detail::common_size(inputs);
+        size_t words = detail::words_needed<WordType>(size);
+        std::vector<uint32_t> counts(size);
+        detail::vertical_counters<WordType> counters(std::size(inputs));
+        for (size_t base = 0; base < words; base += counters.BlockWords) {
+            size_t n = std::min(counters.BlockWords, words - base);
+            counters.accumulate(inputs, base, n);
+            for (size_t p = 0; p < counters.planes; p++) {
+                const WordType *x = counters.plane(p);
+                for (size_t w = 0; w < n; w++) {
+                    size_t pos = (base + w) * WordBits;
+                    for (size_t b = 0; b < WordBits && pos + b < size; b++) {
+                        counts[pos + b] |= static_cast<uint32_t>((x[w] >> b) & 1) << p;
+                    }
+                }
+            }
+        }
+        return counts;
+    }
+
+    // the positions set in at least k of the inputs, without materialising the counts
+    template <typename Inputs>
+    bitvector<detail::input_word_type<Inputs>> threshold(const Inputs &inputs, size_t k)
+    {
+        using WordType = detail::input_word_type<Inputs>;
+        if (std::empty(inputs)) {
+            return bitvector<WordType>(0);
+        }
+        size_t size = detail::common_size(inputs);
+        size_t words = detail::words_needed<WordType>(size);
+        std::vector<WordType> out(words);
+        if (k == 0) {
+            std::fill(out.begin(), out.end(), static_cast<WordType>(~static_cast<WordType>(0)));
+        } else if (k <= std::size(inputs)) {
+            detail::vertical_counters<WordType> counters(std::size(inputs));
+            for (size_t base = 0; base < words; base += counters.BlockWords) {
+                size_t n = std::min(counters.BlockWords, words - base);
+                counters.accumulate(inputs, base, n);
+                counters.at_least(k, out.data() + base, n);
+            }
+        }
+        return bitvector<WordType>(size, std::move(out));
+    }
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+// opt-in instrumentation of bitarray_impl operations, build with -DBITARRAY_PROFILE
+// every operation counts calls, bytes touched and rdtsc cycles into per-thread counters,
+// one slot per (operation, storage type), and bitarray::profile::dump() sums them over all threads
+// only the outermost operation is recorded, so e.g. none() calling any() counts once
+// without BITARRAY_PROFILE the hooks expand to nothing
+
+#ifdef BITARRAY_PROFILE
+
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+#include <x86intrin.h>
+
+namespace bitarray::profile
+{
+    enum class op
+    {
+        all, any, none, count, count_and, count_or, count_xor,
+        countr_zero, countr_one, countl_zero, countl_one, bit_width, bit_floor, bit_ceil,
+        wordswap, set, set_pos, set_indices, to_indices, reset, reset_pos, flip, flip_pos,
+        set_word_at_pos, get_word_at_pos, equal, test,
+        and_, or_, xor_, shift_left, shift_right, rotl, rotr,
+    };
+    constexpr std::array op_names{
+        "all", "any", "none", "count", "count_and", "count_or", "count_xor",
+        "countr_zero", "countr_one", "countl_zero", "countl_one", "bit_width", "bit_floor", "bit_ceil",
+        "wordswap", "set", "set(pos)", "set_indices", "to_indices", "reset", "reset(pos)", "flip", "flip(pos)",
+        "set_word_at_pos", "get_word_at_pos", "==", "test",
+        "&=", "|=", "^=", "<<=", ">>=", "rotl", "rotr",
+    };
+
+    struct entry
+    {
+        std::string op;
+        std::string type;
+        uint64_t calls = 0;
+        uint64_t bytes = 0;
+        uint64_t cycles = 0;
+    };
+
+    namespace detail
+    {
+        // sites past the capacity share the last slot, reported as "(overflow)"
+        constexpr size_t max_sites = 1024;
+
+        struct counter
+        {
+            std::atomic<uint64_t> calls, bytes, cycles;
+        };
+
+        struct thread_counters;
+
+        struct registry
+        {
+            std::mutex mutex;
+            std::vector<entry> sites;
+            std::vector<thread_counters *> threads;
+            // totals of threads that have exited
+            std::array<entry, max_sites> retired;
+        };
+        inline registry &global()
+        {
+            static registry r;
+            return r;
+        }
+
+        struct thread_counters
+        {
+            std::array<counter, max_sites> counters{};
+
+            thread_counters()
+            {
+                std::lock_guard lock{global().mutex};
+                global().threads.push_back(this);
+            }
+            ~thread_counters()
+            {
+                std::lock_guard lock{global().mutex};
+                for (size_t i = 0; i < max_sites; i++) {
+                    global().retired[i].calls += counters[i].calls.load(std::memory_order_relaxed);
+                    global().retired[i].bytes += counters[i].bytes.load(std::memory_order_relaxed);
+                    global().retired[i].cycles += counters[i].cycles.load(std::memory_order_relaxed);
+                }
+                std::erase(global().threads, this);
+            }
+            // only the owning thread writes, so a relaxed load and store is enough for dump() to read it race free
+            void add(size_t site, uint64_t bytes, uint64_t cycles)
+            {
+                auto &c = counters[site];
+                c.calls.store(c.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                c.bytes.store(c.bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+                c.cycles.store(c.cycles.load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+            }
+        };
+        inline thread_counters &local()
+        {
+            thread_local thread_counters t;
+            return t;
+        }
+        inline unsigned &depth()
+        {
+            thread_local unsigned d = 0;
+            return d;
+        }
+
+        inline std::string demangle(const char *name)
+        {
+            int status = 0;
+            char *s = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+            std::string out = status == 0 ? s : name;
+            std::free(s);
+            return out;
+        }
+        inline size_t register_site(op o, std::string type)
+        {
+            std::lock_guard lock{global().mutex};
+            auto &sites = global().sites;
+            if (sites.size() + 1 >= max_sites) {
+                if (sites.size() + 1 == max_sites) {
+                    sites.push_back({"(overflow)", "(overflow)"});
+                }
+                return max_sites - 1;
+            }
+            sites.push_back({op_names[static_cast<size_t>(o)], type});
+            return sites.size() - 1;
+        }
+
+        // registered on first use, so operations run while initialising other globals get the right slot
+        template <typename Specific, op Op>
+        size_t site()
+        {
+            static const size_t s = register_site(Op, demangle(typeid(Specific).name()));
+            return s;
+        }
+
+        // literal type so it can sit in constexpr functions, and does nothing during constant evaluation
+        struct scope
+        {
+            size_t site = 0;
+            uint64_t bytes;
+            uint64_t start = 0;
+            bool outer = false;
+
+            constexpr scope(size_t (*get_site)(), uint64_t bytes) : bytes(bytes)
+            {
+                if (!std::is_constant_evaluated()) {
+                    outer = depth()++ == 0;
+                    if (outer) {
+                        site = get_site();
+                        start = __rdtsc();
+                    }
+                }
+            }
+            constexpr ~scope()
+            {
+                if (!std::is_constant_evaluated()) {
+                    if (outer) {
+                        local().add(site, bytes, __rdtsc() - start);
+                    }
+                    depth()--;
+                }
+            }
+        };
+    }
+
+    // totals over all threads, live and exited, for every site that has been called
+    inline std::vector<entry> snapshot()
+    {
+        auto &g = detail::global();
+        std::lock_guard lock{g.mutex};
+        std::vector<entry> out;
+        for (size_t i = 0; i < g.sites.size(); i++) {
+            entry e = g.sites[i];
+            e.calls = g.retired[i].calls;
+            e.bytes = g.retired[i].bytes;
+            e.cycles = g.retired[i].cycles;
+            for (auto t : g.threads) {
+                e.calls += t->counters[i].calls.load(std::memory_order_relaxed);
+                e.bytes += t->counters[i].bytes.load(std::memory_order_relaxed);
+                e.cycles += t->counters[i].cycles.load(std::memory_order_relaxed);
+            }
+            if (e.calls != 0) {
+                out.push_back(e);
+            }
+        }
+        return out;
+    }
+
+    // a table of snapshot(), most cycles first
+    inline void dump(std::ostream &os)
+    {
+        auto entries = snapshot();
+        std::sort(entries.begin(), entries.end(), [](auto &a, auto &b) { return a.cycles > b.cycles; });
+        os << std::left << std::setw(16) << "op" << std::setw(48) << "type" << std::right
+           << std::setw(14) << "calls" << std::setw(16) << "bytes" << std::setw(18) << "cycles" << std::setw(14) << "cycles/call" << "\n";
+        for (auto &e : entries) {
+            os << std::left << std::setw(16) << e.op << std::setw(48) << e.type << std::right
+               << std::setw(14) << e.calls << std::setw(16) << e.bytes << std::setw(18) << e.cycles << std::setw(14) << e.cycles / e.calls << "\n";
+        }
+    }
+
+    // zeroes all counters, calls racing with reset() on other threads may survive it
+    inline void reset()
+    {
+        auto &g = detail::global();
+        std::lock_guard lock{g.mutex};
+        for (auto &e : g.retired) {
+            e.calls = e.bytes = e.cycles = 0;
+        }
+        for (auto t : g.threads) {
+            for (auto &c : t->counters) {
+                c.calls.store(0, std::memory_order_relaxed);
+                c.bytes.store(0, std::memory_order_relaxed);
+                c.cycles.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+#define BITARRAY_PROFILE_OP(name, bytes) \
+    ::bitarray::profile::detail::scope bitarray_profile_scope_{&::bitarray::profile::detail::site<Specific, ::bitarray::profile::op::name>, (bytes)}
+
+#else
+
+#define BITARRAY_PROFILE_OP(name, bytes)
+
+#endif
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "bitarray.hh"
+#include "popcount-simd.hh"
+
+namespace bitarray::detail
+{
+    template <typename T, size_t Align>
+    struct aligned_allocator
+    {
+        using value_type = T;
+        template <typename U>
+        struct rebind
+        {
+            using other = aligned_allocator<U, Align>;
+        };
+
+        aligned_allocator() = default;
+        template <typename U>
+        aligned_allocator(const aligned_allocator<U, Align> &) {}
+
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+        }
+        void deallocate(T *p, size_t)
+        {
+            ::operator delete(p, std::align_val_t{Align});
+        }
+        template <typename U>
+        bool operator==(const aligned_allocator<U, Align> &) const
+        {
+            return true;
+        }
+    };
+}
+
+namespace bitarray {
+    // jaccard and tanimoto are the same measure on sets of bits
+    enum class metric
+    {
+        tanimoto,
+        jaccard = tanimoto,
+        hamming,
+    };
+
+    // score is a similarity for tanimoto (higher is better) and a distance for hamming (lower is better)
+    struct match
+    {
+        size_t index;
+        double score;
+    };
+
+    template <size_t Bits, typename WordType = size_t>
+    struct fingerprints
+    {
+        using value_type = bitarray<Bits, WordType>;
+        static constexpr size_t alignment = 64;
+
+        // fingerprints are stored back to back, starting on a cache line
+        std::vector<value_type, detail::aligned_allocator<value_type, alignment>> data_;
+        // precomputed count() of each fingerprint, for the cardinality bound
+        std::vector<size_t> counts_;
+        // worker threads for search() and top_k(), 0 is treated as 1
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+        void reserve(size_t n)
+        {
+            data_.reserve(n);
+            counts_.reserve(n);
+        }
+        void push_back(const value_type &x)
+        {
+            data_.push_back(x);
+            counts_.push_back(x.count());
+        }
+        size_t size() const
+        {
+            return data_.size();
+        }
+        const value_type &operator[](size_t i) const
+        {
+            return data_[i];
+        }
+
+        // all fingerprints scoring at least as well as threshold, in index order
+        std::vector<match> search(const value_type &query, double threshold, metric m = metric::tanimoto) const
+        {
+            size_t query_count = query.count();
+            std::vector<std::vector<match>> partial(chunks());
+            parallel_for([&](size_t chunk, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (!may_reach(m, threshold, query_count, counts_[i]))
+                        continue;
+                    double s = score(m, common(query, i), query_count, counts_[i]);
+                    if (!better(m, threshold, s))
+                        partial[chunk].push_back({i, s});
+                }
+            });
+            std::vector<match> out;
+            for (auto &p : partial)
+                out.insert(out.end(), p.begin(), p.end());
+            return out;
+        }
+
+        // the k best scoring fingerprints, best first, ties broken by lowest index
+        std::vector<match> top_k(const value_type &query, size_t k, metric m = metric::tanimoto) const
+        {
+            if (k == 0)
+                return {};
+            size_t query_count = query.count();
+            auto ranks_before = [m](const match &a, const match &b) {
+                if (a.score != b.score)
+                    return better(m, a.score, b.score);
+                return a.index < b.index;
+            };
+            std::vector<std::vector<match>> partial(chunks());
+            parallel_for([&](size_t chunk, size_t begin, size_t end) {
+                // max-heap on rank, so the top is the worst match kept so far
+                std::priority_queue<match, std::vector<match>, decltype(ranks_before)> heap{ranks_before};
+                for (size_t i = begin; i < end; i++) {
+                    // a later index can only displace the worst match by strictly beating it
+                    if (heap.size() == k && !may_beat(m, heap.top().score, query_count, counts_[i]))
+                        continue;
+                    match x{i, score(m, common(query, i), query_count, counts_[i])};
+                    if (heap.size() < k) {
+                        heap.push(x);
+                    } else if (ranks_before(x, heap.top())) {
+                        heap.pop();
+                        heap.push(x);
+                    }
+                }
+                for (; !heap.empty(); heap.pop())
+                    partial[chunk].push_back(heap.top());
+            });
+            std::vector<match> out;
+            for (auto &p : partial)
+                out.insert(out.end(), p.begin(), p.end());
+            std::sort(out.begin(), out.end(), ranks_before);
+            if (out.size() > k)
+                out.resize(k);
+            return out;
+        }
+
+    private:
+        static constexpr size_t min_chunk = 4096;
+
+        size_t common(const value_type &query, size_t i) const
+        {
+            return popcount_and(query.data().data(), data_[i].data().data(), sizeof(typename value_type::Container));
+        }
+        static double score(metric m, size_t common, size_t a, size_t b)
+        {
+            if (m == metric::hamming)
+                return a + b - 2 * common;
+            size_t u = a + b - common;
+            return u == 0 ? 1.0 : static_cast<double>(common) / u;
+        }
+        static bool better(metric m, double a, double b)
+        {
+            return m == metric::hamming ? a < b : a > b;
+        }
+        // upper bound on the score from the counts alone
+        // tanimoto <= min(a, b) / max(a, b), hamming >= |a - b|
+        static double bound(metric m, size_t a, size_t b)
+        {
+            if (m == metric::hamming)
+                return a > b ? a - b : b - a;
+            size_t lo = std::min(a, b), hi = std::max(a, b);
+            return hi == 0 ? 1.0 : static_cast<double>(lo) / hi;
+        }
+        static bool may_reach(metric m, double threshold, size_t a, size_t b)
+        {
+            return !better(m, threshold, bound(m, a, b));
+        }
+        static bool may_beat(metric m, double worst, size_t a, size_t b)
+        {
+            return better(m, bound(m, a, b), worst);
+        }
+
+        size_t chunks() const
+        {
+            return std::clamp<size_t>(size() / min_chunk, 1, std::max<size_t>(threads, 1));
+        }
+        template <typename F>
+        void parallel_for(F f) const
+        {
+            size_t n = chunks();
+            if (n == 1) {
+                f(0, 0, size());
+                return;
+            }
+            std::vector<std::jthread> workers;
+            for (size_t c = 0; c < n; c++) {
+                workers.emplace_back(f, c, size() * c / n, size() * (c + 1) / n);
+            }
+        }
+    };
+}
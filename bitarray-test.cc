@@ -1,4 +1,7 @@
 #include "bitarray.hh"
+#include "bitarray-search.hh"
+#include "bitarray-positional.hh"
+#include "bitarray-aggregate.hh"
 #include <iostream>
 #include <gtest/gtest.h>
 
@@ -6,6 +9,9 @@
 #include <array>
 #include <span>
 #include <type_traits>
+#include <random>
+#include <sstream>
+#include <thread>
 
 #ifdef TYPE
 using type = TYPE;
@@ -146,6 +152,372 @@ TEST(bitarray, fuzz_shift){
     }
 }
 
+TEST(bitarray, constexpr_masks){
+    // interleave masks computed at compile time
+    constexpr auto masks = [] {
+        std::array<bitarray::bitarray<64, type>, 3> x{};
+        for (size_t i = 0; i < x.size(); i++) {
+            for (size_t j = i; j < 64; j += x.size()) {
+                x[i].set(j);
+            }
+        }
+        return x;
+    }();
+    static_assert(masks[0].count() == 22);
+    static_assert(masks[1].count() == 21);
+    static_assert(masks[2].countr_zero() == 2);
+    static_assert(masks[0].count_and(masks[1]) == 0);
+    static_assert(bitarray::bitarray<100, type>{}.set().all());
+    static_assert(bitarray::bitarray<100, type>{}.set(70).bit_floor().countr_zero() == 70);
+    static_assert(bitarray::bitarray<7, type>{}.set(2).set(5).bit_ceil().countr_zero() == 6);
+    static_assert((bitarray::bitarray<7, type>{}.set() >> 3).count() == 4);
+    ASSERT_EQ(masks[0].count() + masks[1].count() + masks[2].count(), 64);
+}
+
+TEST(bitarray, unchecked){
+    bitarray::bitarray<100, type> a, b;
+    for (size_t i = 0; i < a.size(); i += 3) {
+        a.set(i);
+        b.unchecked_set(i);
+    }
+    ASSERT_EQ(a, b);
+    for (size_t i = 0; i < a.size(); i++) {
+        ASSERT_EQ(a.test(i), b.unchecked_test(i));
+        ASSERT_EQ(a.at(i), a[i]);
+    }
+    b.unchecked_flip(3).unchecked_reset(6);
+    a.flip(3).reset(6);
+    ASSERT_EQ(a, b);
+    ASSERT_THROW(a.set(100), std::out_of_range);
+    ASSERT_THROW(a.test(100), std::out_of_range);
+    ASSERT_THROW(a.flip(100), std::out_of_range);
+}
+
+TEST(bitarray, fuzz_small){
+    auto check = [](auto x) {
+        constexpr size_t len = decltype(x)::StaticBits;
+        for (size_t pos = 0; pos < len; pos++) {
+            decltype(x) y {};
+            y.set(pos);
+            ASSERT_EQ(y.countl_zero(), len - 1 - pos);
+            ASSERT_EQ(y.countr_zero(), pos);
+            ASSERT_EQ(y.bit_width(), pos + 1);
+            ASSERT_EQ((y << 1).count(), pos + 1 < len);
+            ASSERT_EQ((y >> 1).count(), pos != 0);
+            y.flip();
+            ASSERT_EQ(y.countl_one(), len - 1 - pos);
+            ASSERT_EQ(y.countr_one(), pos);
+            ASSERT_FALSE(y.all());
+            y.flip(pos);
+            ASSERT_TRUE(y.all());
+            ASSERT_EQ(y.count(), len);
+        }
+        ASSERT_EQ(decltype(x){}.countr_zero(), len);
+        ASSERT_EQ(decltype(x){}.countl_zero(), len);
+    };
+    check(bitarray::bitarray<1, type>{});
+    check(bitarray::bitarray<7, type>{});
+    check(bitarray::bitarray<8, type>{});
+    check(bitarray::bitarray<64, type>{});
+    check(bitarray::bitarray<100, type>{});
+    check(bitarray::bitarray<128, type>{});
+    check(bitarray::bitarray<300, type>{});
+}
+
+TEST(bitarray, fused_count){
+    std::mt19937_64 rng{1};
+    for (int i = 0; i < 100; i++) {
+        bitarray::bitarray<1024, type> a, b;
+        for (size_t j = 0; j < a.size(); j++) {
+            a.set(j, rng() & 1);
+            b.set(j, rng() & 1);
+        }
+        size_t c_and = 0, c_or = 0, c_xor = 0, c_and_prefix = 0;
+        for (size_t j = 0; j < a.size(); j++) {
+            // 72 bytes, so the SIMD loop leaves a scalar tail
+            if (j < 72 * 8)
+                c_and_prefix += a[j] & b[j];
+            c_and += a[j] & b[j];
+            c_or += a[j] | b[j];
+            c_xor += a[j] ^ b[j];
+        }
+        ASSERT_EQ(a.count_and(b), c_and);
+        ASSERT_EQ(a.count_or(b), c_or);
+        ASSERT_EQ(a.count_xor(b), c_xor);
+        ASSERT_EQ(popcount_and(a.data().data(), b.data().data(), sizeof(a.data())), c_and);
+        ASSERT_EQ(popcount_and(a.data().data(), b.data().data(), 72), c_and_prefix);
+    }
+}
+
+TEST(bitarray, fingerprint_search){
+    constexpr size_t len = 1024;
+    std::mt19937_64 rng{2};
+    bitarray::fingerprints<len, type> db;
+    db.threads = 4;
+    for (size_t i = 0; i < 10000; i++) {
+        bitarray::bitarray<len, type> x;
+        // varying densities so the cardinality bound prunes something
+        size_t density = 1 + i % 8;
+        for (size_t j = 0; j < len; j++) {
+            x.set(j, rng() % 16 < density);
+        }
+        db.push_back(x);
+    }
+    auto query = db[1234];
+    for (auto m : {bitarray::metric::tanimoto, bitarray::metric::hamming}) {
+        std::vector<bitarray::match> expected;
+        for (size_t i = 0; i < db.size(); i++) {
+            size_t common = query.count_and(db[i]);
+            size_t either = query.count_or(db[i]);
+            double s = m == bitarray::metric::hamming ? either - common : static_cast<double>(common) / either;
+            expected.push_back({i, s});
+        }
+        auto ranks_before = [m](const bitarray::match &a, const bitarray::match &b) {
+            if (a.score != b.score)
+                return m == bitarray::metric::hamming ? a.score < b.score : a.score > b.score;
+            return a.index < b.index;
+        };
+        std::sort(expected.begin(), expected.end(), ranks_before);
+
+        auto top = db.top_k(query, 10, m);
+        ASSERT_EQ(top.size(), 10);
+        ASSERT_EQ(top[0].index, 1234);
+        for (size_t i = 0; i < top.size(); i++) {
+            ASSERT_EQ(top[i].index, expected[i].index);
+            ASSERT_EQ(top[i].score, expected[i].score);
+        }
+
+        double threshold = expected[50].score;
+        auto found = db.search(query, threshold, m);
+        size_t n = 0;
+        for (auto &e : expected)
+            n += ranks_before(e, {db.size(), threshold});
+        ASSERT_EQ(found.size(), n);
+        ASSERT_TRUE(std::is_sorted(found.begin(), found.end(), [](auto &a, auto &b) { return a.index < b.index; }));
+        for (auto &f : found)
+            ASSERT_FALSE(ranks_before({db.size(), threshold}, f));
+    }
+    // no worker threads runs on the calling thread
+    db.threads = 0;
+    ASSERT_EQ(db.top_k(query, 1)[0].index, 1234);
+}
+
+TEST(bitarray, positional_popcount){
+    std::mt19937_64 rng{3};
+    for (size_t num : {1, 2, 7, 64, 300}) {
+        constexpr size_t len = 1000;
+        std::vector<bitarray::bitvector<type>> inputs;
+        for (size_t i = 0; i < num; i++) {
+            inputs.emplace_back(len);
+            // varying densities so the counts spread out
+            for (size_t j = 0; j < len; j++) {
+                inputs.back().set(j, rng() % num <= i);
+            }
+        }
+        std::vector<uint32_t> expected(len);
+        for (auto &x : inputs)
+            for (size_t j = 0; j < len; j++)
+                expected[j] += x[j];
+        ASSERT_EQ(bitarray::positional_popcount(inputs), expected);
+
+        std::vector<const bitarray::bitvector<type> *> pointers;
+        for (auto &x : inputs)
+            pointers.push_back(&x);
+        for (size_t k : {size_t{0}, size_t{1}, num / 2, num, num + 1}) {
+            auto out = bitarray::threshold(pointers, k);
+            ASSERT_EQ(out.size(), len);
+            for (size_t j = 0; j < len; j++)
+                ASSERT_EQ(out[j], expected[j] >= k);
+        }
+    }
+    {
+        std::array<bitarray::bitarray<70, type>, 3> inputs{};
+        inputs[0].set(1).set(69);
+        inputs[1].set(1);
+        inputs[2].set(1).set(69).set(2);
+        auto counts = bitarray::positional_popcount(inputs);
+        ASSERT_EQ(counts[1], 3);
+        ASSERT_EQ(counts[2], 1);
+        ASSERT_EQ(counts[69], 2);
+        ASSERT_EQ(bitarray::threshold(inputs, 2).count(), 2);
+    }
+    {
+        std::vector<bitarray::bitvector<type>> inputs{bitarray::bitvector<type>(10), bitarray::bitvector<type>(11)};
+        ASSERT_THROW(bitarray::positional_popcount(inputs), std::invalid_argument);
+    }
+}
+
+TEST(bitarray, aggregate){
+    std::mt19937_64 rng{4};
+    // large enough to span several blocks of 8 KiB
+    constexpr size_t len = 100000 + 7;
+    constexpr size_t block_bits = 8192 * 8;
+    std::vector<bitarray::bitvector<type>> inputs;
+    for (size_t i = 0; i < 20; i++) {
+        inputs.emplace_back(len);
+        for (size_t j = 0; j < len; j++) {
+            // dense, but one input clears the whole first block, so the intersection stops early there
+            inputs.back().set(j, (rng() % 8 != 0 || j < len / 2) && !(i == 3 && j < block_bits));
+        }
+    }
+    auto expected_or = inputs[0], expected_and = inputs[0], expected_xor = inputs[0];
+    for (size_t i = 1; i < inputs.size(); i++) {
+        expected_or |= inputs[i];
+        expected_and &= inputs[i];
+        expected_xor ^= inputs[i];
+    }
+    ASSERT_EQ(bitarray::union_all(inputs), expected_or);
+    ASSERT_EQ(bitarray::intersect_all(inputs), expected_and);
+    ASSERT_EQ(bitarray::xor_all(inputs), expected_xor);
+    ASSERT_EQ(bitarray::union_count(inputs), expected_or.count());
+    ASSERT_EQ(bitarray::intersect_count(inputs), expected_and.count());
+    ASSERT_EQ(bitarray::xor_count(inputs), expected_xor.count());
+    ASSERT_NE(expected_and.count(), 0);
+    ASSERT_GE(expected_and.countr_zero(), block_bits);
+
+    // mixed storage types through view()
+    bitarray::bitarray<200, type> a;
+    bitarray::bitvector<type> b(200);
+    std::vector<type> words(bitarray::detail::words_needed<type>(200));
+    bitarray::bitspan<std::dynamic_extent, type> c(200, words);
+    a.set(1).set(2).set(199);
+    b.set(2).set(3).set(199);
+    c.set(2).set(199).set(150);
+    std::vector mixed{bitarray::view(a), bitarray::view(b), bitarray::view(c)};
+    auto u = bitarray::union_all(mixed);
+    ASSERT_EQ(u.size(), 200);
+    ASSERT_EQ(u.count(), 5);
+    ASSERT_EQ(bitarray::intersect_all(mixed).count(), 2);
+    ASSERT_EQ(bitarray::xor_count(mixed), 5);
+
+    std::vector<bitarray::bitvector<type>> different{bitarray::bitvector<type>(10), bitarray::bitvector<type>(11)};
+    ASSERT_THROW(bitarray::union_all(different), std::invalid_argument);
+    ASSERT_EQ(bitarray::union_count(std::vector<bitarray::bitvector<type>>{}), 0);
+}
+
+TEST(bitarray, indices){
+    std::mt19937_64 rng{5};
+    constexpr size_t len = 1000 + 3;
+    for (size_t density : {2, 50, 99}) {
+        std::vector<uint32_t> idx;
+        bitarray::bitvector<type> expected(len);
+        for (size_t j = 0; j < len; j++) {
+            // long runs, so whole words are filled
+            if (rng() % 100 < density || (j > 300 && j < 600)) {
+                idx.push_back(j);
+                expected.set(j);
+            }
+        }
+        ASSERT_EQ(bitarray::bitvector<type>::from_indices(len, idx), expected);
+        ASSERT_EQ(expected.to_indices<uint32_t>(), idx);
+        // unsorted, with duplicates
+        auto shuffled = idx;
+        shuffled.insert(shuffled.end(), idx.begin(), idx.begin() + idx.size() / 2);
+        std::shuffle(shuffled.begin(), shuffled.end(), rng);
+        ASSERT_EQ(bitarray::bitvector<type>::from_indices(len, shuffled), expected);
+        // sorted, with duplicates
+        std::sort(shuffled.begin(), shuffled.end());
+        ASSERT_EQ(bitarray::bitvector<type>::from_indices(len, shuffled), expected);
+    }
+    constexpr auto a = bitarray::bitarray<100, type>::from_indices(std::array{0, 1, 2, 50, 99});
+    static_assert(a.count() == 5 && a[50]);
+    ASSERT_EQ(a.to_indices(), (std::vector<size_t>{0, 1, 2, 50, 99}));
+    ASSERT_THROW(a.from_indices(std::vector{1, 100}), std::out_of_range);
+    ASSERT_THROW(a.from_indices(std::vector{100, 1}), std::out_of_range);
+    ASSERT_THROW(a.from_indices(std::vector{-1, 1}), std::out_of_range);
+    ASSERT_TRUE(a.from_indices(std::vector<int>{}).none());
+}
+
+TEST(bitarray, bitset){
+    std::bitset<100> s;
+    s.set(0).set(63).set(64).set(99);
+    bitarray::bitarray<100, type> a(s);
+    ASSERT_EQ(a.count(), 4);
+    ASSERT_TRUE(a[0] && a[63] && a[64] && a[99]);
+    ASSERT_EQ(a.to_bitset(), s);
+    std::bitset<64> t{0x8000'0000'0000'0001};
+    bitarray::bitarray<64, type> b(t);
+    ASSERT_EQ(b.to_indices(), (std::vector<size_t>{0, 63}));
+    ASSERT_EQ(b.to_bitset(), t);
+    static_assert(bitarray::bitarray<128, uint64_t>::bitset_layout_compatible == (std::endian::native == std::endian::little));
+    static_assert(bitarray::bitarray<128, uint64_t>(std::bitset<128>{5}).count() == 2);
+}
+
+#ifdef BITARRAY_PROFILE
+// profiled while initialising globals, the volatile keeps it from being constant initialised
+size_t static_init_count = [] {
+    volatile size_t n = 77;
+    bitarray::bitarray<77, type> x;
+    for (size_t i = 0; i < n; i++) {
+        x.set(i);
+    }
+    return x.count();
+}();
+
+TEST(bitarray, profile_static_init){
+    ASSERT_EQ(static_init_count, 77);
+    auto entries = bitarray::profile::snapshot();
+    auto calls = [&](std::string op) {
+        for (auto &e : entries)
+            if (e.op == op && e.type.find("bitarray<77") != std::string::npos)
+                return e.calls;
+        return uint64_t{0};
+    };
+    ASSERT_EQ(calls("set(pos)"), 77);
+    ASSERT_EQ(calls("count"), 1);
+}
+
+TEST(bitarray, profile){
+    bitarray::profile::reset();
+    bitarray::bitarray<100, type> a;
+    for (size_t i = 0; i < 10; i++) {
+        a.set(i);
+    }
+    a.none();
+    std::thread([] {
+        bitarray::bitarray<100, type> b;
+        b.set();
+        b.none();
+    }).join();
+    auto entries = bitarray::profile::snapshot();
+    auto find = [&](std::string op) {
+        for (auto &e : entries)
+            if (e.op == op && e.type.find("bitarray<100") != std::string::npos)
+                return e;
+        return bitarray::profile::entry{};
+    };
+    ASSERT_EQ(find("set(pos)").calls, 10);
+    ASSERT_EQ(find("set(pos)").bytes, 10 * sizeof(type));
+    ASSERT_EQ(find("set").calls, 1);
+    ASSERT_EQ(find("none").calls, 2);
+    ASSERT_EQ(find("none").bytes, 2 * sizeof(a.data()));
+    // only the outermost operation is counted
+    ASSERT_EQ(find("any").calls, 0);
+    std::ostringstream os;
+    bitarray::profile::dump(os);
+    ASSERT_NE(os.str().find("set(pos)"), std::string::npos);
+    bitarray::profile::reset();
+    ASSERT_TRUE(bitarray::profile::snapshot().empty());
+}
+
+TEST(bitarray, profile_overflow){
+    namespace detail = bitarray::profile::detail;
+    size_t site = 0;
+    while (site != detail::max_sites - 1) {
+        site = detail::register_site(bitarray::profile::op::all, "filler");
+    }
+    ASSERT_EQ(detail::register_site(bitarray::profile::op::any, "filler"), detail::max_sites - 1);
+    detail::local().add(site, 8, 100);
+    detail::local().add(detail::register_site(bitarray::profile::op::none, "filler"), 8, 100);
+    auto entries = bitarray::profile::snapshot();
+    auto overflow = std::find_if(entries.begin(), entries.end(), [](auto &e) { return e.op == "(overflow)"; });
+    ASSERT_NE(overflow, entries.end());
+    ASSERT_EQ(overflow->calls, 2);
+    ASSERT_EQ(overflow->bytes, 16);
+    bitarray::profile::reset();
+}
+#endif
+
 #if 0
 TEST(bitarray, fuzz_rotate){
     constexpr int len = 128;
@@ -1,15 +1,23 @@
+#pragma once
+
 #include <cstdint>
 #include <limits>
 #include <iostream>
 #include <bit>
+#include <bitset>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
 #include <optional>
 #include <array>
 #include <vector>
 #include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 #include "pdep-pext.hh"
+#include "bitarray-profile.hh"
 #include "bitarray-impl.hh"
 
 namespace bitarray::detail
@@ -36,6 +44,7 @@ namespace bitarray {
     template <size_t Bits, typename WordType>
     struct bitarray_traits
     {
+        static constexpr size_t StaticBits = Bits;
         using Container = std::array<WordType, detail::words_needed<WordType>(Bits)>;
     };
 
@@ -45,16 +54,60 @@ namespace bitarray {
         using self_type = bitarray<Bits, WordType>;
         using base_type = bitarray_impl<bitarray<Bits, WordType>, bitarray_traits<Bits, WordType>>;
 
-        bitarray()
+        constexpr bitarray() = default;
+        constexpr bitarray(std::initializer_list<WordType> l) : base_type(l) {}
+
+        // std::bitset isn't trivially copyable by the standard, but is in all the major implementations,
+        // and when its size matches it has the same little endian layout, so conversion is a std::bit_cast
+        static constexpr bool bitset_layout_compatible =
+            std::endian::native == std::endian::little &&
+            std::is_trivially_copyable_v<std::bitset<Bits>> &&
+            sizeof(std::bitset<Bits>) == sizeof(typename base_type::Container);
+
+        explicit constexpr bitarray(const std::bitset<Bits> &b)
         {
-            base_type::sanitize();
+            if constexpr (bitset_layout_compatible)
+            {
+                base_type::data_ = std::bit_cast<typename base_type::Container>(b);
+            }
+            else
+            {
+                for (size_t i = 0; i < Bits; i++)
+                {
+                    base_type::unchecked_set(i, b[i]);
+                }
+            }
+        }
+        constexpr std::bitset<Bits> to_bitset() const
+        {
+            if constexpr (bitset_layout_compatible)
+            {
+                return std::bit_cast<std::bitset<Bits>>(base_type::data_);
+            }
+            else
+            {
+                std::bitset<Bits> b;
+                for (size_t i = 0; i < Bits; i++)
+                {
+                    b[i] = base_type::unchecked_test(i);
+                }
+                return b;
+            }
+        }
+
+        template <typename Indices>
+        static constexpr self_type from_indices(const Indices &indices)
+        {
+            self_type x;
+            x.set_indices(indices);
+            return x;
         }
-        bitarray(std::initializer_list<WordType> l) : base_type(l) {}
     };
 
     template <typename WordType>
     struct bitvector_traits
     {
+        static constexpr size_t StaticBits = std::dynamic_extent;
         using Container = std::vector<WordType>;
     };
 
@@ -66,20 +119,27 @@ namespace bitarray {
 
         size_t _size = std::dynamic_extent;
 
-        bitvector() {}
-        bitvector(std::vector<WordType> v) : base_type(v)
+        constexpr bitvector() {}
+        constexpr bitvector(std::vector<WordType> v) : base_type(v)
         {
             _size = detail::bits_in_container(base_type::data_);
         }
-        bitvector(size_t size) : _size(size)
+        constexpr bitvector(size_t size) : _size(size)
         {
             resize(_size);
         }
-        bitvector(size_t size, std::vector<WordType> v) : base_type(v), _size(size)
+        constexpr bitvector(size_t size, std::vector<WordType> v) : base_type(v), _size(size)
         {
             base_type::sanitize();
         }
-        void resize(size_t s)
+        template <typename Indices>
+        static constexpr self_type from_indices(size_t size, const Indices &indices)
+        {
+            self_type x(size);
+            x.set_indices(indices);
+            return x;
+        }
+        constexpr void resize(size_t s)
         {
             size_t needed = detail::words_needed<WordType>(s);
             if (std::size(base_type::data_) < needed)
@@ -93,6 +153,7 @@ namespace bitarray {
     template <size_t Bits, typename WordType>
     struct bitspan_traits
     {
+        static constexpr size_t StaticBits = Bits;
         using Container = std::span<WordType, detail::words_needed<WordType>(Bits)>;
     };
 
@@ -104,10 +165,13 @@ namespace bitarray {
 
         size_t _size;
 
-        bitspan(std::span<WordType, Bits> s) : base_type(s), _size(Bits) {}
-        bitspan(size_t size, std::span<WordType, Bits> s) : base_type(s), _size(size)
+        constexpr bitspan(std::span<WordType, detail::words_needed<WordType>(Bits)> s) : base_type(s), _size(Bits) {}
+        constexpr bitspan(size_t size, std::span<WordType, detail::words_needed<WordType>(Bits)> s) : base_type(s), _size(size)
         {
-            base_type::sanitize();
+            if constexpr (!std::is_const_v<WordType>)
+            {
+                base_type::sanitize();
+            }
         }
         void resize(size_t s)
         {
@@ -122,4 +186,40 @@ namespace bitarray {
         self_type operator<<(size_t) = delete;
         self_type operator>>(size_t) = delete;
     };
+
+    // a read-only bitspan over any bitarray, bitvector or bitspan, e.g. to pass different storage types to one function
+    template <typename T>
+    constexpr bitspan<std::dynamic_extent, const typename T::WordType> view(const T &x)
+    {
+        return {x.size(), std::span<const typename T::WordType>(x.data())};
+    }
+}
+
+namespace bitarray::detail
+{
+    // helpers for functions over a range of same-size bitarrays, bitvectors or bitspans, or pointers to them
+    template <typename T>
+    constexpr const auto &deref(const T &x)
+    {
+        if constexpr (std::is_pointer_v<T>) {
+            return *x;
+        } else {
+            return x;
+        }
+    }
+
+    template <typename Inputs>
+    using input_word_type = typename std::remove_cvref_t<decltype(deref(*std::begin(std::declval<const Inputs &>())))>::WordType;
+
+    template <typename Inputs>
+    size_t common_size(const Inputs &inputs)
+    {
+        size_t size = deref(*std::begin(inputs)).size();
+        for (auto &x : inputs) {
+            if (deref(x).size() != size) {
+                throw std::invalid_argument{"inputs of size " + std::to_string(deref(x).size()) + " and " + std::to_string(size) + " differ"};
+            }
+        }
+        return size;
+    }
 }
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <immintrin.h>
+#include <bit>
+
+namespace {
+// popcount(a & b) over two byte ranges in a single pass
+inline size_t popcount_and(const void *a, const void *b, size_t bytes) {
+    auto pa = static_cast<const unsigned char *>(a);
+    auto pb = static_cast<const unsigned char *>(b);
+    size_t count = 0;
+    size_t i = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    __m512i acc = _mm512_setzero_si512();
+    for (; i + 64 <= bytes; i += 64) {
+        __m512i x = _mm512_and_si512(_mm512_loadu_si512(pa + i), _mm512_loadu_si512(pb + i));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+    }
+    // summed by hand, gcc 12's _mm512_reduce_add_epi64 trips -Wmaybe-uninitialized
+    uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, acc);
+    for (auto lane : lanes)
+        count += lane;
+#elif defined(__AVX2__)
+    // nibble lookup popcount, Mula et al. "Faster Population Counts Using AVX2 Instructions"
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    );
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i x = _mm256_and_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pa + i)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pb + i))
+        );
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+        __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    count += _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+           + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+#endif
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, pa + i, 8);
+        std::memcpy(&y, pb + i, 8);
+        count += std::popcount(x & y);
+    }
+    for (; i < bytes; i++) {
+        count += std::popcount(static_cast<unsigned char>(pa[i] & pb[i]));
+    }
+    return count;
+}
+}